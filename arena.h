@@ -0,0 +1,164 @@
+#ifndef arena_h
+#define arena_h
+
+#include <new>
+#include <vector>
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Bump allocation for what lives as long as a manifest: its paths and
+ * map nodes. Memory comes from CHUNK sized chunks that are only given
+ * back when the arena is destroyed, so allocating is usually a pointer
+ * bump and nothing fragments the heap.
+ *
+ * Freed small blocks go on a free list per 16 byte size class and are
+ * reused, so entries coming and going in a long running daemon don't
+ * grow the arena without bound. Large blocks, such as long paths and
+ * the bucket arrays of a map, are rare: each gets its own malloc and is
+ * freed when deallocated.
+ *
+ * Not thread safe, CShardedMap keeps one arena per shard under the
+ * shard's lock.
+ */
+
+class CArena {
+public:
+	CArena()
+	: next_(nullptr)
+	, end_(nullptr)
+	{
+		large_.prev = large_.next = &large_;
+		for (auto &f : free_)
+			f = nullptr;
+	}
+
+	~CArena()
+	{
+		for (auto c : chunks_)
+			free(c);
+		while (large_.next != &large_)
+			free_large(large_.next);
+	}
+
+	CArena(const CArena &) = delete;
+	CArena &operator=(const CArena &) = delete;
+
+	void *allocate(size_t size)
+	{
+		size = round(size);
+		if (size <= MAX_REUSED && free_[size / ALIGN - 1]) {
+			CFree *f = free_[size / ALIGN - 1];
+			free_[size / ALIGN - 1] = f->next;
+			return f;
+		}
+		if (size > MAX_REUSED)
+			return allocate_large(size);
+		if (size > (size_t)(end_ - next_))
+			return grow(size);
+		void *p = next_;
+		next_ += size;
+		return p;
+	}
+
+	void deallocate(void *p, size_t size)
+	{
+		size = round(size);
+		if (size > MAX_REUSED) {
+			free_large(static_cast<CLarge *>(p) - 1);
+			return;
+		}
+		CFree *f = static_cast<CFree *>(p);
+		f->next = free_[size / ALIGN - 1];
+		free_[size / ALIGN - 1] = f;
+	}
+
+	/* a nul terminated copy of s */
+	const char *copy(const char *s, size_t len)
+	{
+		char *p = static_cast<char *>(allocate(len + 1));
+		memcpy(p, s, len);
+		p[len] = 0;
+		return p;
+	}
+
+private:
+	enum { ALIGN = 16, MAX_REUSED = 512, CHUNK = 256 * 1024 };
+
+	struct CFree {
+		CFree *next;
+	};
+
+	/* the header of a large block, which follows it */
+	struct CLarge {
+		CLarge *prev;
+		CLarge *next;
+	};
+
+	static size_t round(size_t size) { return size ? (size + ALIGN - 1) & ~(size_t)(ALIGN - 1) : ALIGN; }
+
+	void *allocate_large(size_t size)
+	{
+		CLarge *l = static_cast<CLarge *>(malloc(sizeof(CLarge) + size));
+		if (!l)
+			throw std::bad_alloc();
+		l->prev = &large_;
+		l->next = large_.next;
+		l->next->prev = l;
+		large_.next = l;
+		return l + 1;
+	}
+
+	void free_large(CLarge *l)
+	{
+		l->prev->next = l->next;
+		l->next->prev = l->prev;
+		free(l);
+	}
+
+	void *grow(size_t size)
+	{
+		next_ = static_cast<char *>(malloc(CHUNK));
+		if (!next_)
+			throw std::bad_alloc();
+		chunks_.push_back(next_);
+		end_ = next_ + CHUNK;
+		void *p = next_;
+		next_ += size;
+		return p;
+	}
+
+	char *next_;
+	char *end_;
+	std::vector<char *> chunks_;
+	CFree *free_[MAX_REUSED / ALIGN];
+	CLarge large_; /* list of large blocks */
+};
+
+/* a standard allocator taking its memory from a CArena */
+template <class T>
+class CArenaAllocator {
+public:
+	typedef T value_type;
+	template <class U> struct rebind { typedef CArenaAllocator<U> other; };
+
+	explicit CArenaAllocator(CArena *arena) : arena_(arena) { }
+	template <class U>
+	CArenaAllocator(const CArenaAllocator<U> &o) : arena_(o.arena()) { }
+
+	T *allocate(size_t n) { return static_cast<T *>(arena_->allocate(n * sizeof(T))); }
+	void deallocate(T *p, size_t n) { arena_->deallocate(p, n * sizeof(T)); }
+
+	CArena *arena() const { return arena_; }
+	template <class U>
+	bool operator==(const CArenaAllocator<U> &o) const { return arena_ == o.arena(); }
+	template <class U>
+	bool operator!=(const CArenaAllocator<U> &o) const { return arena_ != o.arena(); }
+
+private:
+	CArena *arena_;
+};
+
+#endif // arena_h
@@ -0,0 +1,49 @@
+#ifndef fail_h
+#define fail_h
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <string>
+
+/*
+ * Errors of the library code, thrown rather than exiting so a program
+ * using libhashsync decides what to do about them. The tools catch them
+ * in main() and exit with error() as they always did, see tools.h.
+ */
+
+class CError : public std::runtime_error {
+public:
+	CError(int err, const std::string &message)
+	: std::runtime_error(err ? message + ": " + strerror(err) : message)
+	, err_(err)
+	, message_(message)
+	{ }
+
+	/* errno, or 0 */
+	int err() const { return err_; }
+	/* what() without strerror(err()) */
+	const char *message() const { return message_.c_str(); }
+
+private:
+	int err_;
+	std::string message_;
+};
+
+/* throw a CError, the arguments are those of error() after the status */
+inline void fail(int err, const char *format, ...)
+    __attribute__((noreturn, format(printf, 2, 3)));
+
+inline void fail(int err, const char *format, ...)
+{
+	char message[1024];
+	va_list ap;
+	va_start(ap, format);
+	vsnprintf(message, sizeof(message), format, ap);
+	va_end(ap);
+	throw CError(err, message);
+}
+
+#endif // fail_h
@@ -0,0 +1,345 @@
+#ifndef hashsync_h
+#define hashsync_h
+
+/*
+ * libhashsync: maintaining and comparing ".sha1s" manifests in process,
+ * as update_sha1s and compare_sha1s do.
+ *
+ * C++ use:
+ *   CManifest m(".sha1s");
+ *   m.options.remove_missing = true;
+ *   m.on_change([](const char *op, const std::string &path, const std::string &detail) { ... });
+ *   m.load();
+ *   bool changed = m.update();
+ *   changed = m.settle() || changed;
+ *   changed = m.remove() || changed;
+ *   if (changed)
+ *           m.write();
+ *
+ * Paths are relative to the current directory, which is the root of the
+ * tree, and start with "./" as update_sha1s records them.
+ *
+ * Changes are reported through the callback rather than printed. op is
+ * one of:
+ *   add, mod     path was hashed (or found in an xattr or the cache)
+ *   rem, exp     path was removed as missing (-c) or expired (-i)
+ *   mov          path was renamed to detail
+ *   bad          path no longer matches its sha1 (verify)
+ *   busy         path kept changing and was left for the next run
+ *   settle       detail fresh files are being waited for
+ *   noxattr      path has no current xattr (rebuild)
+ *   xattr        setting path's xattr failed with error detail
+ *   skip         path is not a regular file, detail says why
+ *   slow         path took longer than options.slow_ns, detail has figures
+ *   noring       options.queue_depth is ignored, io_uring could not be set
+ *                up for the reason in detail
+ *   new          path is the manifest file, which load() found missing
+ *
+ * With options.workers above 1 update() hashes files on that many
+ * threads while the calling thread walks the tree, the callback is then
+ * called from those threads, one call at a time. On NUMA machines the
+ * threads are pinned to nodes unless options.numa is cleared. With
+ * options.queue_depth each of them keeps that many files in flight
+ * through io_uring, and with options.largest_first they hash the biggest
+ * files first, see update().
+ *
+ * Errors throw a CError (see fail.h) with errno and a message, the
+ * manifest is then left as it was or partly updated but never half
+ * written. An error on one of the workers stops the others and is thrown
+ * by update() once they have finished. Statistics of all manifests are
+ * gathered in the global stats, see stats.h.
+ *
+ * The C API at the end wraps the common cases for other languages.
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sha1s.h"
+#include "shardedmap.h"
+
+struct CHashJobs;
+class CPathQueue;
+class CSha1Cache;
+class CThrottle;
+class CUring;
+struct CUringTask;
+
+struct CUpdateOptions {
+	long ignore_seconds = 0; /* ignore and expire files older than this */
+	long block_threshold = 0; /* record block sha1s for files this big */
+	long block_size = 1024 * 1024;
+	bool content_defined = false; /* chunks= instead of blocks= */
+	long settle_seconds = 3; /* wait for files modified more recently, a day at most */
+	bool use_xattrs = false;
+	long verify_percent = 0;
+	bool remove_missing = false;
+	long workers = 1; /* threads hashing in update(), stat'ing in rebuild() and estimate() */
+	bool numa = true; /* spread hashing threads over NUMA nodes, see update() */
+	long queue_depth = 0; /* files each update() thread has in flight with io_uring */
+	bool largest_first = false; /* parallel update() hashes the biggest files first */
+	uint64_t slow_ns = 0; /* report files slower than this to hash */
+	CSha1Cache *cache = nullptr;
+	CThrottle *throttle = nullptr;
+};
+
+inline bool operator==(const struct timespec &lhs, const struct timespec &rhs)
+{
+	return (lhs.tv_sec == rhs.tv_sec) && (lhs.tv_nsec == rhs.tv_nsec);
+}
+
+class CFileHash {
+public:
+	CFileHash()
+	: st_mtim_{0, 0}
+	, touched_{false}
+	{ }
+
+	CFileHash(const std::string &hash, const struct timespec &st_mtim, bool touched = false)
+	: hash_(hash)
+	, st_mtim_(st_mtim)
+	, touched_(touched)
+	{ }
+
+	CFileHash(const CFileHash &o)
+	: hash_(o.hash_)
+	, st_mtim_(o.st_mtim_)
+	, touched_(o.touched())
+	, extra_(o.extra_)
+	{ }
+
+	CFileHash(CFileHash &&o)
+	: hash_(std::move(o.hash_))
+	, st_mtim_(o.st_mtim_)
+	, touched_(o.touched())
+	, extra_(std::move(o.extra_))
+	{ }
+
+	CFileHash &operator=(const CFileHash &o)
+	{
+		hash_ = o.hash_;
+		st_mtim_ = o.st_mtim_;
+		touch(o.touched());
+		extra_ = o.extra_;
+		return *this;
+	}
+
+	CFileHash &operator=(CFileHash &&o)
+	{
+		hash_ = std::move(o.hash_);
+		st_mtim_ = o.st_mtim_;
+		touch(o.touched());
+		extra_ = std::move(o.extra_);
+		return *this;
+	}
+
+	/* may be called while other threads update other entries */
+	void touch(bool touched = true) { touched_.store(touched, std::memory_order_relaxed); }
+	bool touched() const { return touched_.load(std::memory_order_relaxed); }
+	const struct timespec& modified() const { return st_mtim_; }
+	const std::string& hash() const { return hash_; }
+	std::vector<std::string>& extra() { return extra_; }
+	const std::vector<std::string>& extra() const { return extra_; }
+	bool has_extra(const char *key) const
+	{
+		return get_extra(key) != nullptr;
+	}
+	const char *get_extra(const char *key) const
+	{
+		const size_t len = strlen(key);
+		for (auto &e : extra_)
+			if (e.compare(0, len, key) == 0 && e[len] == '=')
+				return e.c_str() + len + 1;
+		return nullptr;
+	}
+	void set_extra(const char *key, const std::string &value)
+	{
+		const size_t len = strlen(key);
+		for (auto &e : extra_)
+			if (e.compare(0, len, key) == 0 && e[len] == '=') {
+				e.replace(len + 1, std::string::npos, value);
+				return;
+			}
+		extra_.push_back(key + ("=" + value));
+	}
+
+private:
+	std::string hash_; /* sha1 hash */
+	struct timespec st_mtim_; /* last modification time */
+	std::atomic<bool> touched_;
+	std::vector<std::string> extra_; /* optional key=value fields */
+};
+
+typedef CShardedMap<CFileHash> CFileHashMap;
+
+typedef std::function<void(const char *op, const std::string &path,
+    const std::string &detail)> CChangeCallback;
+
+/* what update() and remove() would do, see estimate() */
+struct CEstimate {
+	uint64_t unchanged_files, unchanged_bytes;
+	uint64_t add_files, add_bytes;
+	uint64_t mod_files, mod_bytes;
+	uint64_t hash_files, hash_bytes;
+	uint64_t ignored_files, ignored_bytes;
+	uint64_t removed_files;
+	uint64_t expired_files;
+};
+
+class CManifest {
+public:
+	explicit CManifest(const char *file = ".sha1s");
+
+	CUpdateOptions options;
+
+	void on_change(const CChangeCallback &cb) { on_change_ = cb; }
+	/* called for each directory update() walks, before reading it */
+	void on_directory(const std::function<void(const std::string &)> &cb) { on_directory_ = cb; }
+
+	/* refresh the time files' ages are measured against */
+	void tick();
+	const struct timespec &now() const { return now_; }
+
+	/* load the manifest, if there is one */
+	void load();
+	/* write the manifest, replacing the file atomically */
+	void write() const;
+
+	CFileHashMap &files() { return files_; }
+	const CFileHash *find(const std::string &path) const;
+
+	/*
+	 * Update every file under path, queueing files modified too recently.
+	 * Returns true if any entry changed.
+	 */
+	bool update(const std::string &path = ".");
+	/* update a single file, see update() */
+	bool update_file(const std::string &path);
+	/* wait for the queued files to settle and update them */
+	bool settle();
+	/*
+	 * Remove entries untouched since load() or untouch() if
+	 * options.remove_missing, and expired entries
+	 */
+	bool remove();
+	/*
+	 * Read options.verify_percent of the unchanged files again. Returns
+	 * the number which no longer match, verified is set to the number read.
+	 */
+	size_t verify(bool &updated, size_t &verified);
+	/* replace the entries with the files' xattrs, reading no file */
+	bool rebuild();
+	/* what update() and remove() would do, stat'ing files only */
+	CEstimate estimate();
+
+	/* queue path to be updated once it has settled, at when or later */
+	void defer(const std::string &path, time_t when);
+	/* update queued paths whose time has come */
+	bool update_pending();
+	/* earliest time a queued path is due, 0 if none */
+	time_t next_pending() const;
+	/* mark every entry untouched, except queued ones */
+	void untouch();
+
+	/* a file or directory left the tree */
+	bool forget(const std::string &path, bool dir);
+	/* a file or directory was renamed within the tree */
+	bool move(const std::string &from, const std::string &to, bool dir);
+
+private:
+	bool walk(const std::string &path, const std::function<bool(const std::string &)> &file);
+	std::string calculate_sha1(int fd, std::string *blocks = nullptr);
+	enum CCheck { CHECK_UNCHANGED, CHECK_UPDATED, CHECK_HASH };
+	CCheck check_file(const std::string &path, int fd, const struct stat &sb, bool &want_blocks);
+	bool hashed_file(const std::string &path, int fd, const struct stat &sb, CFileHash &h,
+	    uint64_t start);
+	bool update_file(const std::string &path, CHashJobs *later);
+	bool update_async(CPathQueue &queue, std::atomic<bool> &updated, CHashJobs *later);
+	void report_no_ring(int err);
+	CUringTask update_file_async(CUring &ring, std::string path, size_t &in_flight,
+	    std::atomic<bool> &updated, CHashJobs *later, std::exception_ptr &failed);
+	void set_xattr(int fd, const struct stat &sb, const std::string &hash, const std::string &path);
+	void store_sha1(int fd, const struct stat &sb, const std::string &hash,
+	    const std::string &path, bool xattr);
+	void log_slow(const std::string &path, const struct stat &sb, uint64_t start);
+	void report(const char *op, const std::string &path, const std::string &detail = std::string())
+	{
+		std::lock_guard<std::mutex> l(report_lock_);
+		if (on_change_)
+			on_change_(op, path, detail);
+	}
+
+	std::string file_;
+	struct timespec now_;
+	CFileHashMap files_;
+	std::unordered_map<std::string, time_t> pending_; /* path to settle deadline */
+	std::mutex pending_lock_;
+	CChangeCallback on_change_;
+	std::mutex report_lock_;
+	std::atomic<bool> no_ring_reported_;
+	std::function<void(const std::string &)> on_directory_;
+};
+
+extern "C" {
+#endif
+
+typedef struct hashsync_manifest hashsync_manifest;
+
+/* see CChangeCallback, detail is "" when there is none */
+typedef void (*hashsync_callback)(void *ctx, const char *op, const char *path, const char *detail);
+
+/*
+ * For diffs op is add, mod, rem (a), mov, dup (a to b) or blk (a, off,
+ * len), as compare_sha1s -d prints them. For hashsync_compare op is
+ * always "need" with the remote file in a.
+ */
+typedef void (*hashsync_diff_callback)(void *ctx, const char *op, const char *a,
+    const char *b, long long off, long long len);
+
+/*
+ * Nothing throws or exits. On failure the functions below return -1, or
+ * NULL for hashsync_open, with errno set and the reason in
+ * hashsync_error(), which stays valid until the next failure on the
+ * calling thread.
+ */
+const char *hashsync_error(void);
+
+/* load file, or start an empty manifest */
+hashsync_manifest *hashsync_open(const char *file);
+/*
+ * Set an option of CUpdateOptions by name: ignore_seconds,
+ * block_threshold, block_size, content_defined, settle_seconds,
+ * use_xattrs, verify_percent, remove_missing, workers, numa, queue_depth
+ * or largest_first. Returns -1 for unknown names and for values
+ * update_sha1s would refuse (a block_size outside 64..2^28, say), with
+ * errno EINVAL.
+ */
+int hashsync_set_option(hashsync_manifest *m, const char *name, long value);
+/* update, settle and remove, returns 1 if anything changed */
+int hashsync_update(hashsync_manifest *m, const char *path, hashsync_callback cb, void *ctx);
+/* returns 1 and fills sha1 (41 bytes) and modified if path is known */
+int hashsync_lookup(hashsync_manifest *m, const char *path, char *sha1, struct timespec *modified);
+int hashsync_write(hashsync_manifest *m);
+void hashsync_close(hashsync_manifest *m);
+
+int hashsync_diff(const char *local, const char *remote, hashsync_diff_callback cb, void *ctx);
+int hashsync_compare(const char *local, const char *remote, hashsync_diff_callback cb, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // hashsync_h
@@ -0,0 +1,40 @@
+#ifndef numanodes_h
+#define numanodes_h
+
+#include <vector>
+
+#include <sched.h>
+#include <stddef.h>
+
+/*
+ * The machine's NUMA nodes and the CPUs of each we may run on, read from
+ * /sys/devices/system/node, for placing hashing threads. Nodes without
+ * such CPUs (memory only nodes) are left out. Without sysfs or NUMA
+ * there is a single node holding every CPU we may run on.
+ *
+ * Memory isn't bound explicitly: Linux places a page on the node of the
+ * thread first touching it and glibc gives threads their own malloc
+ * arenas, so what a pinned thread allocates and fills, such as its read
+ * buffer and the map entries it inserts, is node local without libnuma.
+ */
+
+class CNumaNodes {
+public:
+	CNumaNodes();
+
+	size_t size() const { return nodes_.size(); }
+	/* the kernel's number of node i */
+	int id(size_t i) const { return nodes_[i].id; }
+	/* restrict the calling thread to the CPUs of node i */
+	void bind(size_t i) const;
+
+private:
+	struct CNode {
+		int id;
+		cpu_set_t cpus;
+	};
+
+	std::vector<CNode> nodes_;
+};
+
+#endif // numanodes_h
@@ -0,0 +1,37 @@
+#ifndef probes_h
+#define probes_h
+
+/*
+ * USDT probes for tracing with bpftrace, perf or systemtap, e.g.
+ *   bpftrace -e 'usdt:./update_sha1s:hashsync:hash__done { @[arg1] = hist(arg2); }'
+ *
+ * Probes are a nop instruction plus an ELF note, so cost next to
+ * nothing until attached. Without <sys/sdt.h> they compile away.
+ *
+ * Probes and arguments:
+ *   load__start(file)                  load__done(file, records)
+ *   write__start(file)                 write__done(file, records)
+ *   dir__open(path)
+ *   file__stat(path, size, ns)
+ *   hash__start(fd)                    hash__done(fd, bytes, ns)
+ *   compare__match(fname)              compare__miss(fname)
+ */
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HASHSYNC_HAVE_SDT 1
+#endif
+#endif
+
+#ifdef HASHSYNC_HAVE_SDT
+#define PROBE1(name, a) DTRACE_PROBE1(hashsync, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(hashsync, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(hashsync, name, a, b, c)
+#else
+#define PROBE1(name, a) do { } while (0)
+#define PROBE2(name, a, b) do { } while (0)
+#define PROBE3(name, a, b, c) do { } while (0)
+#endif
+
+#endif // probes_h
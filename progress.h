@@ -0,0 +1,44 @@
+#ifndef progress_h
+#define progress_h
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+/*
+ * Report the progress of a run from the counters in stats.h, read by a
+ * thread of its own so the workers only ever bump atomics.
+ *
+ * Reports go to stderr, redrawn in place every second on a terminal
+ * and as a log line every ten seconds otherwise, or to a status file
+ * rewritten every second. The ETA is based on bytes if the number of
+ * bytes to hash is known (a pre-count of a new tree), otherwise on the
+ * expected number of files (the previous manifest's).
+ */
+
+class CProgress {
+public:
+	CProgress() : stop_(false), files_(0), bytes_(0) { }
+	~CProgress() { stop(); }
+
+	void start(const char *dest, uint64_t files, uint64_t bytes);
+	void stop();
+
+private:
+	void run();
+	std::string line(double elapsed, double rate) const;
+	void report(const std::string &line, bool last);
+
+	std::string dest_;
+	bool tty_;
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	bool stop_;
+	uint64_t files_;
+	uint64_t bytes_;
+};
+
+#endif // progress_h
@@ -0,0 +1,100 @@
+#ifndef proto_h
+#define proto_h
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "sha1s.h"
+
+/*
+ * serve_sha1s wire protocol.
+ *
+ * All integers are big endian, strings are a u32 length followed by the
+ * bytes, at most PROTO_MAX_STRING of them. A record is fname, time,
+ * hash, u32 count, extra strings.
+ *
+ * Client:
+ *   "HSY1"
+ *   u32 count, count * (fname, hash)    summary of the client's sha1s
+ * Server:
+ *   "HSY1"
+ *   u32 count, count * record           server files the client needs
+ *   u32 count, count * fname            client files the server lacks
+ * Then the client sends requests without waiting for replies:
+ *   u32 index, u64 offset, u64 length   read from a needed file
+ *   u32 PROTO_BYE                       end of requests
+ * and the server replies to each request in order:
+ *   u32 errno, u32 mode, u64 mtime_sec, u64 mtime_nsec, u64 size,
+ *   u64 length, length bytes of data
+ *
+ * A request length of PROTO_EOF reads to the end of the file, a request
+ * length of 0 only fetches the file's metadata.
+ */
+
+#define PROTO_MAGIC "HSY1"
+#define PROTO_BYE 0xffffffffU
+#define PROTO_EOF UINT64_MAX
+#define PROTO_MAX_STRING (64U << 20) /* room for the block sha1s of a huge file */
+
+/*
+ * query_sha1s wire protocol, integers and strings as above.
+ *
+ * Client:
+ *   "HSQ1"
+ * Then any number of batches, each answered before the next is read:
+ *   u32 QUERY_PATH, u32 count, count * fname
+ *   u32 QUERY_HASH, u32 count, count * sha1
+ *   u32 PROTO_BYE                       end of queries
+ * Server, for QUERY_PATH, for each fname:
+ *   u32 errno, sha1                     sha1 is empty if errno is set
+ * for QUERY_HASH, for each sha1:
+ *   u32 count, count * fname            files currently with that sha1
+ */
+
+#define QUERY_MAGIC "HSQ1"
+#define QUERY_PATH 1
+#define QUERY_HASH 2
+
+class CWriter {
+public:
+	CWriter(int fd) : fd_(fd) { }
+	~CWriter() { flush(); }
+
+	void put_u32(uint32_t v);
+	void put_u64(uint64_t v);
+	void put_string(const std::string &s);
+	void put(const void *p, size_t len);
+	void flush(bool more = false);
+
+private:
+	int fd_;
+	std::string buf_;
+};
+
+class CReader {
+public:
+	CReader(int fd) : fd_(fd), pos_(0) { }
+
+	uint32_t get_u32();
+	uint64_t get_u64();
+	std::string get_string();
+	void get(void *p, size_t len);
+	void copy_to(int fd, off_t off, uint64_t len);
+	void skip(uint64_t len);
+
+private:
+	size_t fill();
+
+	int fd_;
+	std::vector<char> buf_;
+	size_t pos_;
+};
+
+void put_record(CWriter &w, const CFileRecord &r);
+CFileRecord get_record(CReader &rd);
+
+int listen_address(const char *address);
+int connect_address(const char *address);
+
+#endif // proto_h
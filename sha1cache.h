@@ -0,0 +1,57 @@
+#ifndef sha1cache_h
+#define sha1cache_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include <sys/stat.h>
+
+/*
+ * A sha1 cache shared by every process using the same cache file, e.g.
+ * update_sha1s runs on manifests with overlapping roots.
+ *
+ * The file is a fixed size open addressed hash table of slots keyed by
+ * st_dev & st_ino, mmapped shared. A slot is only a hit if size, mtime
+ * and ctime also match. Each slot has a sequence number which is odd
+ * while the slot is written, next to the time the writer took it: writers
+ * make it odd and simply give up if another writer has it, readers retry
+ * nothing and treat a slot that changed under them as a miss. A slot
+ * held for over CACHE_LEASE seconds, by a writer that died or was
+ * stopped, is taken over by the next writer, which moves the sequence
+ * number on as any write does. Only the clock is shared, so processes in
+ * other pid namespaces or containers can share the file too.
+ */
+
+struct CCacheSlot {
+	uint64_t lock; /* sequence number, and when it went odd in the high half */
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime_sec;
+	int64_t ctime_sec;
+	uint32_t mtime_nsec;
+	uint32_t ctime_nsec;
+	uint8_t sha1[20];
+};
+
+class CSha1Cache {
+public:
+	CSha1Cache() : slots_(nullptr), nslots_(0), map_size_(0) { }
+	~CSha1Cache();
+
+	void open(const char *file, uint64_t nslots = 1 << 22);
+	bool is_open() const { return slots_ != nullptr; }
+
+	bool get(const struct stat &sb, std::string &hash) const;
+	void put(const struct stat &sb, const std::string &hash);
+
+private:
+	CCacheSlot *slot(const struct stat &sb, size_t probe) const;
+
+	CCacheSlot *slots_;
+	uint64_t nslots_;
+	size_t map_size_;
+};
+
+#endif // sha1cache_h
@@ -0,0 +1,110 @@
+#ifndef sha1s_h
+#define sha1s_h
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Reading and writing of ".sha1s" files.
+ *
+ * File format:
+ *   filename<NULL>modified_sec.modified_nsec<NULL>sha1<NULL>[key=value<NULL>...]\n
+ *
+ * Older files may terminate records with <NULL> instead of \n, both are
+ * accepted when loading. See update_sha1s.C for the optional fields.
+ *
+ * Errors throw a CError, see fail.h.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+struct CFileRecord {
+	std::string fname;
+	std::string time;
+	std::string hash;
+	std::vector<std::string> extra; /* optional key=value fields */
+};
+
+typedef std::vector<CFileRecord> CFileRecords;
+
+/* byte offset & length */
+typedef std::vector<std::pair<off_t, off_t>> CRanges;
+
+std::string get_string(const char *&it, const char *buf, const size_t size);
+/*
+ * With missing, a file that doesn't exist loads as no records and sets
+ * *missing, otherwise that is an error like any other.
+ */
+CFileRecords load_sha1s(const char *file, bool *missing = nullptr);
+void write_sha1s(const char *file, const CFileRecords &records);
+
+/*
+ * Writes records to file.tmp as they are added, commit() renames it over
+ * file.
+ */
+class CSha1sWriter {
+public:
+	explicit CSha1sWriter(const char *file);
+	~CSha1sWriter();
+	CSha1sWriter(const CSha1sWriter &) = delete;
+	CSha1sWriter &operator=(const CSha1sWriter &) = delete;
+
+	void add(const char *fname, const char *time, const std::string &hash,
+	    const std::vector<std::string> &extra);
+	void commit();
+
+private:
+	std::string file_;
+	std::string tmp_;
+	FILE *f_;
+	size_t records_;
+};
+
+const std::string *find_extra(const CFileRecord &r, const char *key);
+
+bool diff_blocks(const CFileRecord &from, const CFileRecord &to, CRanges &ranges, size_t *nblocks = nullptr);
+
+struct CBlock {
+	uint32_t weak;
+	std::string hash;
+};
+
+typedef std::vector<CBlock> CBlocks;
+
+bool get_blocks(const CFileRecord &r, off_t &block_size, CBlocks &blocks);
+
+struct CChunk {
+	off_t off;
+	off_t len;
+	std::string hash;
+};
+
+typedef std::vector<CChunk> CChunks;
+
+struct CChunkRef {
+	const CFileRecord *file;
+	off_t off;
+	off_t len;
+};
+
+/* chunk sha1 -> one place holding the chunk */
+typedef std::unordered_map<std::string, CChunkRef> CChunkIndex;
+
+bool get_chunks(const CFileRecord &r, CChunks &chunks);
+void index_chunks(const CFileRecord &r, CChunkIndex &index);
+
+/*
+ * op is "add", "mod" or "rem" for a, "mov" or "dup" from a to b, or "blk"
+ * with the changed ranges of a. compare_sha1s() only reports "need".
+ */
+typedef std::function<void(const char *op, const std::string &a, const std::string *b,
+    const CRanges *ranges)> CDiffCallback;
+
+void compare_sha1s(const CFileRecords &local, const CFileRecords &remote, const CDiffCallback &cb);
+void diff_sha1s(const CFileRecords &local, const CFileRecords &remote, const CDiffCallback &cb);
+
+#endif // sha1s_h
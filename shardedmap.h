@@ -0,0 +1,257 @@
+#ifndef shardedmap_h
+#define shardedmap_h
+
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+
+/*
+ * A string keyed hash map which threads can look up and insert into
+ * concurrently, for the manifest of a parallel update.
+ *
+ * Keys are spread over SHARDS unordered_maps by hash, each guarded by a
+ * spin lock held only for the lookup or insertion itself, so threads
+ * working on different paths rarely wait for each other and never for a
+ * global lock.
+ *
+ * get(), operator[], erase(key), count() and size() are thread safe.
+ * Pointers and references to values stay valid until their key is
+ * erased (unordered_map never moves its nodes), so a value may be used
+ * after its shard is unlocked, provided no other thread is working on
+ * the same key. Iteration and erase(iterator) are for when no other
+ * thread is using the map.
+ *
+ * Each shard keeps its nodes and a copy of each key in its own CArena,
+ * so the map makes no heap allocation per entry of its own. Iterating
+ * gives CPathKeys, which look keys up without copying them.
+ */
+
+/* a key kept in a CArena, or a std::string's being looked up */
+class CPathKey {
+public:
+	CPathKey(const char *data, size_t size) : data_(data), size_(size) { }
+	explicit CPathKey(const std::string &s) : data_(s.data()), size_(s.size()) { }
+
+	/* nul terminated */
+	const char *c_str() const { return data_; }
+	size_t size() const { return size_; }
+	std::string str() const { return std::string(data_, size_); }
+	operator std::string() const { return str(); }
+
+	bool operator==(const CPathKey &o) const
+	{
+		return size_ == o.size_ && memcmp(data_, o.data_, size_) == 0;
+	}
+	bool operator==(const std::string &s) const { return *this == CPathKey(s); }
+	bool operator!=(const std::string &s) const { return !(*this == s); }
+
+private:
+	const char *data_;
+	size_t size_;
+};
+
+/* FNV-1a, then mixed so that the top bits which pick a shard are good */
+struct CPathKeyHash {
+	size_t operator()(const CPathKey &k) const
+	{
+		uint64_t h = 0xcbf29ce484222325ULL;
+		for (size_t i = 0; i < k.size(); ++i)
+			h = (h ^ (uint8_t)k.c_str()[i]) * 0x100000001b3ULL;
+		h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+		h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+		return h ^ (h >> 33);
+	}
+};
+
+class CSpinLock {
+public:
+	CSpinLock() : locked_(false) { }
+
+	void lock()
+	{
+		for (unsigned spins = 0; locked_.exchange(true, std::memory_order_acquire); ++spins)
+			while (locked_.load(std::memory_order_relaxed))
+				if (++spins > 100)
+					sched_yield();
+	}
+
+	void unlock() { locked_.store(false, std::memory_order_release); }
+
+private:
+	std::atomic<bool> locked_;
+};
+
+template <class V>
+class CShardedMap {
+	enum { SHARD_BITS = 6, SHARDS = 1 << SHARD_BITS };
+
+	typedef std::pair<const CPathKey, V> CEntry;
+	typedef std::unordered_map<CPathKey, V, CPathKeyHash, std::equal_to<CPathKey>,
+	    CArenaAllocator<CEntry>> CShard;
+
+	struct CLockedShard {
+		CLockedShard()
+		: map(0, CPathKeyHash(), std::equal_to<CPathKey>(), CArenaAllocator<CEntry>(&arena))
+		{ }
+
+		mutable CSpinLock lock;
+		CArena arena; /* before map, which uses it until destroyed */
+		CShard map;
+	};
+
+	template <class Map, class Inner, class Value>
+	class basic_iterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef Value value_type;
+		typedef ptrdiff_t difference_type;
+		typedef Value *pointer;
+		typedef Value &reference;
+
+		basic_iterator(Map *map, size_t shard, Inner it)
+		: map_(map)
+		, shard_(shard)
+		, it_(it)
+		{
+			skip();
+		}
+
+		Value &operator*() const { return *it_; }
+		Value *operator->() const { return &*it_; }
+		basic_iterator &operator++()
+		{
+			++it_;
+			skip();
+			return *this;
+		}
+		bool operator==(const basic_iterator &o) const { return shard_ == o.shard_ && it_ == o.it_; }
+		bool operator!=(const basic_iterator &o) const { return !(*this == o); }
+
+	private:
+		friend class CShardedMap;
+
+		/* move past the ends of shards, stopping at the end of the last */
+		void skip()
+		{
+			while (shard_ + 1 < SHARDS && it_ == map_->shards_[shard_].map.end())
+				it_ = map_->shards_[++shard_].map.begin();
+		}
+
+		Map *map_;
+		size_t shard_;
+		Inner it_;
+	};
+
+public:
+	typedef typename CShard::value_type value_type;
+	typedef basic_iterator<CShardedMap, typename CShard::iterator, value_type> iterator;
+	typedef basic_iterator<const CShardedMap, typename CShard::const_iterator,
+	    const value_type> const_iterator;
+
+	CShardedMap() { }
+	CShardedMap(const CShardedMap &) = delete;
+	CShardedMap &operator=(const CShardedMap &) = delete;
+
+	/* the value of key, nullptr if there is none */
+	V *get(const std::string &key)
+	{
+		const CPathKey k(key);
+		CLockedShard &s = shard(k);
+		std::lock_guard<CSpinLock> l(s.lock);
+		auto it = s.map.find(k);
+		return it == s.map.end() ? nullptr : &it->second;
+	}
+
+	const V *get(const std::string &key) const
+	{
+		return const_cast<CShardedMap *>(this)->get(key);
+	}
+
+	/* the value of key, inserting a default one if there is none */
+	V &operator[](const std::string &key)
+	{
+		const CPathKey k(key);
+		CLockedShard &s = shard(k);
+		std::lock_guard<CSpinLock> l(s.lock);
+		auto it = s.map.find(k);
+		if (it != s.map.end())
+			return it->second;
+		const CPathKey copy(s.arena.copy(key.data(), key.size()), key.size());
+		return s.map.emplace(copy, V()).first->second;
+	}
+
+	size_t erase(const std::string &key)
+	{
+		const CPathKey k(key);
+		CLockedShard &s = shard(k);
+		std::lock_guard<CSpinLock> l(s.lock);
+		auto it = s.map.find(k);
+		if (it == s.map.end())
+			return 0;
+		erase(s, it);
+		return 1;
+	}
+
+	size_t count(const std::string &key) const { return get(key) ? 1 : 0; }
+
+	size_t size() const
+	{
+		size_t n = 0;
+		for (auto &s : shards_) {
+			std::lock_guard<CSpinLock> l(s.lock);
+			n += s.map.size();
+		}
+		return n;
+	}
+
+	bool empty() const { return size() == 0; }
+
+	void clear()
+	{
+		for (auto &s : shards_) {
+			std::lock_guard<CSpinLock> l(s.lock);
+			for (auto it = s.map.begin(); it != s.map.end();)
+				it = erase(s, it);
+		}
+	}
+
+	iterator begin() { return iterator(this, 0, shards_[0].map.begin()); }
+	iterator end() { return iterator(this, SHARDS - 1, shards_[SHARDS - 1].map.end()); }
+	const_iterator begin() const { return const_iterator(this, 0, shards_[0].map.cbegin()); }
+	const_iterator end() const { return const_iterator(this, SHARDS - 1, shards_[SHARDS - 1].map.cend()); }
+
+	iterator erase(iterator it)
+	{
+		return iterator(this, it.shard_, erase(shards_[it.shard_], it.it_));
+	}
+
+private:
+	CLockedShard &shard(const CPathKey &key)
+	{
+		/* the shard maps use the low bits of the same hash */
+		return shards_[CPathKeyHash()(key) >> (sizeof(size_t) * 8 - SHARD_BITS)];
+	}
+
+	/* erase and give the key's copy back to the arena */
+	typename CShard::iterator erase(CLockedShard &s, typename CShard::iterator it)
+	{
+		const CPathKey k = it->first;
+		it = s.map.erase(it);
+		s.arena.deallocate(const_cast<char *>(k.c_str()), k.size() + 1);
+		return it;
+	}
+
+	CLockedShard shards_[SHARDS];
+};
+
+#endif // shardedmap_h
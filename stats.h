@@ -0,0 +1,89 @@
+#ifndef stats_h
+#define stats_h
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Counters and phase times of an update_sha1s run, printed with -s and
+ * written as JSON with -S. Counters may be bumped from any thread.
+ *
+ * Phases don't overlap: time spent hashing is counted under hash and
+ * taken out of the walk and verify phases it happened in. With several
+ * hashing threads, or files in flight (-a), hash is the sum of their
+ * times.
+ *
+ * When hashing threads are placed on NUMA nodes (see numanodes.h) each
+ * node's files, bytes and hash time are also counted, for the first
+ * MAX_NODES nodes.
+ *
+ * Latencies go into HDR style histograms: buckets are powers of two
+ * split into 32 linear sub-buckets, so any value is known to within
+ * about 3% at a fixed 16KB per histogram.
+ */
+
+class CHistogram {
+public:
+	CHistogram();
+
+	void record(uint64_t ns);
+	uint64_t count() const;
+	uint64_t percentile(double p) const;
+	uint64_t max() const { return max_; }
+
+private:
+	enum { SUB_BITS = 5, SUB_BUCKETS = 1 << SUB_BITS };
+
+	static size_t index(uint64_t v);
+	static uint64_t upper(size_t i);
+
+	std::atomic<uint64_t> buckets_[64 * SUB_BUCKETS];
+	std::atomic<uint64_t> max_;
+};
+
+struct CNodeStats {
+	int id;					/* the kernel's node number */
+	std::atomic<uint64_t> hashed;
+	std::atomic<uint64_t> bytes;
+	std::atomic<uint64_t> hash_ns;		/* summed over the node's threads */
+};
+
+enum {
+	PHASE_LOAD,
+	PHASE_WALK,
+	PHASE_HASH,
+	PHASE_VERIFY,
+	PHASE_WRITE,
+	PHASES
+};
+
+struct CStats {
+	std::atomic<uint64_t> dirs;		/* directories walked */
+	std::atomic<uint64_t> files;		/* regular files found */
+	std::atomic<uint64_t> hashed;		/* files read and hashed */
+	std::atomic<uint64_t> bytes;		/* bytes read and hashed */
+	std::atomic<uint64_t> stat_calls;	/* stat calls */
+	std::atomic<uint64_t> open_calls;	/* open calls */
+	std::atomic<uint64_t> unchanged;	/* files matching sha1s */
+	std::atomic<uint64_t> xattr_hits;	/* sha1s taken from xattrs */
+	std::atomic<uint64_t> cache_hits;	/* sha1s taken from the cache */
+	std::atomic<uint64_t> phase_ns[PHASES];
+	CHistogram open_ns;			/* latency of opening a file */
+	CHistogram stat_ns;			/* latency of stat'ing a file */
+	CHistogram hash_ns;			/* time to read & hash a file */
+	enum { MAX_NODES = 16 };
+	std::atomic<size_t> numa_nodes;		/* nodes hashed on, 0 if not placed */
+	CNodeStats nodes[MAX_NODES];
+
+	CStats();
+	void print(FILE *f) const;
+	void write_json(const char *file) const;
+};
+
+extern CStats stats;
+
+/* monotonic nanoseconds */
+uint64_t stats_clock();
+
+#endif // stats_h
@@ -0,0 +1,70 @@
+#ifndef throttle_h
+#define throttle_h
+
+#include <mutex>
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Pace reads so that other users of the same disks and CPUs are left
+ * room. Callers report each read with account(), which sleeps as long
+ * as any enabled limit is exceeded:
+ *   - bytes and reads per second, each a token bucket holding at most
+ *     a tenth of a second's worth, so idle time can't be saved up
+ *   - a share of one CPU, averaged since the throttle was created
+ *   - I/O pressure: once a second the share of time some task was
+ *     stalled on I/O is taken from /proc/pressure/io, above the limit
+ *     the byte rate is halved (starting from the rate just achieved),
+ *     below half the limit it grows again by a quarter until it no
+ *     longer limits anything. This includes stalls of our own reads.
+ * A limit of 0 is disabled. Threads hashing in parallel share the
+ * limits, taking turns in account().
+ */
+
+class CBucket {
+public:
+	CBucket() : rate_(0), tokens_(0) { }
+
+	void set_rate(double rate, const struct timespec &now);
+	double rate() const { return rate_; }
+	double take(double n, const struct timespec &now);
+
+private:
+	double rate_;
+	double tokens_;
+	struct timespec last_;
+};
+
+class CThrottle {
+public:
+	CThrottle(long rate, long iops, long cpu_percent, long pressure_percent);
+
+	bool enabled() const { return rate_ || iops_ || cpu_percent_ || pressure_percent_; }
+	void account(size_t bytes);
+	/* why the pressure limit was dropped, empty if it wasn't */
+	const std::string &pressure_problem() const { return pressure_problem_; }
+
+private:
+	void check_pressure(const struct timespec &now);
+
+	std::mutex lock_;
+	long rate_;
+	long iops_;
+	long cpu_percent_;
+	long pressure_percent_;
+	std::string pressure_problem_;
+	CBucket bytes_;
+	CBucket reads_;
+	struct timespec start_;
+	struct timespec cpu_start_;
+
+	double adaptive_; /* pressure limited byte rate, 0 if not limiting */
+	uint64_t window_bytes_;
+	uint64_t stall_total_;
+	struct timespec window_start_;
+};
+
+#endif // throttle_h
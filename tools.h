@@ -0,0 +1,81 @@
+#ifndef tools_h
+#define tools_h
+
+#include <errno.h>
+#include <error.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+
+#include "fail.h"
+
+/*
+ * Helpers shared by the command line tools, the benchmark and the stress
+ * test. Like the tools, they exit with a message on bad input.
+ */
+
+/*
+ * Parse a whole number option argument into arg. strtoul() takes "-1"
+ * as ULONG_MAX, which would come out as -1 again, so signs and values
+ * past LONG_MAX are refused here.
+ */
+inline void parse_long_arg(long &arg, const char *s)
+{
+	errno = 0;
+	char* p;
+	const unsigned long v = strtoul(s, &p, 0);
+	if (errno != 0)
+		error(EXIT_FAILURE, errno, "%s", s);
+	if (s == p)
+		error(EXIT_FAILURE, EINVAL, "%s", s);
+	if (*p)
+		error(EXIT_FAILURE, EINVAL, "%s", s);
+	if (strpbrk(s, "-+"))
+		error(EXIT_FAILURE, EINVAL, "%s", s);
+	if (v > LONG_MAX)
+		error(EXIT_FAILURE, ERANGE, "%s", s);
+	arg = v;
+}
+
+/* splitmix64, the same sequence for a seed everywhere */
+class CRandom {
+public:
+	CRandom(uint64_t seed) : state_(seed) { }
+
+	uint64_t next()
+	{
+		uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	/* uniform in [0, n) */
+	uint64_t below(uint64_t n) { return n ? next() % n : 0; }
+	double unit() { return (next() >> 11) * (1.0 / (1ULL << 53)); }
+
+private:
+	uint64_t state_;
+};
+
+/*
+ * The whole of a tool's main(), which passes its real one as tool_main:
+ * the library throws its errors, the tools report them with error() and
+ * exit as they always did.
+ */
+inline int run_tool(int (*tool_main)(int, char *[]), int argc, char *argv[])
+{
+	try {
+		return tool_main(argc, argv);
+	} catch (const CError &e) {
+		error(EXIT_FAILURE, e.err(), "%s", e.message());
+	} catch (const std::bad_alloc &) {
+		error(EXIT_FAILURE, ENOMEM, "out of memory");
+	}
+	return EXIT_FAILURE;
+}
+
+#endif // tools_h
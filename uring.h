@@ -0,0 +1,114 @@
+#ifndef uring_h
+#define uring_h
+
+/*
+ * Just enough io_uring, without liburing, for C++20 coroutines to await
+ * opens, stats and reads with many others in flight on one thread, as
+ * update() does with options.queue_depth.
+ *
+ * A CUringTask is a coroutine which starts at once and frees itself when
+ * it returns. Inside one
+ *   int fd = co_await ring.openat(AT_FDCWD, path, O_RDONLY);
+ * queues the request and suspends. run() submits whatever is queued,
+ * waits for completions and resumes each waiting coroutine with its
+ * result, -errno on failure. Requests are only submitted by run(), so
+ * arguments need only live until the co_await returns.
+ *
+ * Without coroutines (C++20) or <linux/io_uring.h> this declares
+ * nothing, HASHSYNC_HAVE_URING tells. A kernel without io_uring, or a
+ * seccomp filter denying it, shows as !ok().
+ */
+
+#if defined(__has_include) && defined(__cpp_impl_coroutine)
+#if __has_include(<coroutine>) && __has_include(<linux/io_uring.h>)
+#define HASHSYNC_HAVE_URING 1
+#endif
+#endif
+
+#ifdef HASHSYNC_HAVE_URING
+
+#include <coroutine>
+#include <exception>
+
+#include <linux/io_uring.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+struct CUringTask {
+	struct promise_type {
+		CUringTask get_return_object() { return CUringTask(); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() { }
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+/* a queued request, co_await it for the result */
+class CUringOp {
+public:
+	bool await_ready() const { return false; }
+	void await_suspend(std::coroutine_handle<> h)
+	{
+		handle_ = h;
+		sqe_->user_data = (uintptr_t)this;
+	}
+	int await_resume() const { return res_; }
+
+private:
+	friend class CUring;
+
+	explicit CUringOp(struct io_uring_sqe *sqe) : sqe_(sqe), res_(0) { }
+
+	struct io_uring_sqe *sqe_;
+	std::coroutine_handle<> handle_;
+	int res_;
+};
+
+class CUring {
+public:
+	/* for up to entries requests at a time */
+	explicit CUring(unsigned entries);
+	~CUring();
+
+	CUring(const CUring &) = delete;
+	CUring &operator=(const CUring &) = delete;
+
+	bool ok() const { return fd_ >= 0; }
+	int err() const { return err_; } /* why not ok() */
+
+	CUringOp openat(int dfd, const char *path, int flags);
+	CUringOp statx(int dfd, const char *path, int flags, unsigned mask, struct statx *buf);
+	CUringOp read(int fd, void *buf, unsigned len, uint64_t off);
+
+	/* submit, wait for a completion and resume what completed */
+	void run();
+
+private:
+	struct io_uring_sqe *next_sqe();
+
+	int fd_;
+	int err_;
+	void *sq_ring_;
+	void *cq_ring_;
+	size_t sq_ring_size_;
+	size_t cq_ring_size_;
+	struct io_uring_sqe *sqes_;
+	size_t sqes_size_;
+
+	unsigned sq_entries_;
+	unsigned *sq_head_;
+	unsigned *sq_tail_;
+	unsigned sq_mask_;
+	unsigned *sq_array_;
+	unsigned queued_tail_; /* sq tail including requests not yet submitted */
+	unsigned *cq_head_;
+	unsigned *cq_tail_;
+	unsigned cq_mask_;
+	struct io_uring_cqe *cqes_;
+};
+
+#endif // HASHSYNC_HAVE_URING
+
+#endif // uring_h